@@ -22,7 +22,11 @@ export { SymlinkModes } from './src/lib/fs.mjs';
 
 // additional exports
 
-export { DEFAULT_IN_MEMORY_CUTOFF_SIZE } from './src/backup_manager/backup_manager.mjs';
+export {
+  DEFAULT_IN_MEMORY_CUTOFF_SIZE,
+  DEFAULT_LARGE_FILE_CONCURRENCY,
+  DEFAULT_SMALL_FILE_CONCURRENCY,
+} from './src/backup_manager/backup_manager.mjs';
 export {
   BACKUP_PATH_SEP,
   BITS_PER_BYTE,
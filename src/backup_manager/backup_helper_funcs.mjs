@@ -5,6 +5,8 @@ import { SymlinkModes } from '../lib/fs.mjs';
 import {
   createBackupManager,
   DEFAULT_IN_MEMORY_CUTOFF_SIZE,
+  DEFAULT_LARGE_FILE_CONCURRENCY,
+  DEFAULT_SMALL_FILE_CONCURRENCY,
 } from './backup_manager.mjs';
 import {
   DEFAULT_COMPRESS_PARAMS,
@@ -90,6 +92,8 @@ export async function performBackup({
   compressionMaximumSizeThreshold = Infinity,
   checkForDuplicateHashes = true,
   ignoreErrors = false,
+  smallFileConcurrency = DEFAULT_SMALL_FILE_CONCURRENCY,
+  largeFileConcurrency = DEFAULT_LARGE_FILE_CONCURRENCY,
   timestampOnlyFileIdenticalCheckBackup = null,
   logger = console.log,
 }) {
@@ -110,6 +114,8 @@ export async function performBackup({
       compressionMaximumSizeThreshold,
       checkForDuplicateHashes,
       ignoreErrors,
+      smallFileConcurrency,
+      largeFileConcurrency,
       timestampOnlyFileIdenticalCheckBackup,
     });
   } finally {
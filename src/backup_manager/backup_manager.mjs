@@ -17,6 +17,7 @@ import {
   unlink,
   writeFile,
 } from 'node:fs/promises';
+import { availableParallelism } from 'node:os';
 import {
   dirname,
   join,
@@ -25,6 +26,7 @@ import {
 } from 'node:path';
 import { pipeline } from 'node:stream/promises';
 
+import { KeyedAsyncMutex } from '../lib/async_lock.mjs';
 import { CounterStream } from '../lib/counter_stream.mjs';
 import { deepObjectClone } from '../lib/deep_clone.mjs';
 import {
@@ -46,7 +48,7 @@ import {
 } from '../lib/fs.mjs';
 import { callBothLoggers } from '../lib/logger.mjs';
 import { unixSecStringToUnixNSInt } from '../lib/time.mjs';
-import { streamsEqual } from '../lib/stream_equality.mjs';
+import { WorkerPool } from '../lib/worker_pool.mjs';
 import {
   awaitFileDeletion,
   BACKUP_PATH_SEP,
@@ -87,6 +89,8 @@ import {
 import { upgradeDirToCurrent } from './upgrader.mjs';
 
 export const DEFAULT_IN_MEMORY_CUTOFF_SIZE = 4 * 2 ** 20;
+export const DEFAULT_SMALL_FILE_CONCURRENCY = 8;
+export const DEFAULT_LARGE_FILE_CONCURRENCY = 2;
 const FILE_TIMES_SET_CHUNK_SIZE = 50;
 
 class BackupManager {
@@ -109,6 +113,10 @@ class BackupManager {
   #globalLogger;
   #allowFullBackupDirDestroy = false;
   #allowSingleBackupDestroy = false;
+  #fileStoreLocks = new KeyedAsyncMutex();
+  #metaFileLocks = new KeyedAsyncMutex();
+  #tempDirLocks = new KeyedAsyncMutex();
+  #tempDirUsers = 0;
   
   // helper funcs
   
@@ -183,6 +191,15 @@ class BackupManager {
     );
   }
   
+  #hashWorkerArgs(filePath) {
+    return {
+      filePath,
+      hashAlgo: this.#hashAlgo,
+      hashParams: this.#hashParams,
+      hashOutputTrimLength: this.#hashOutputTrimLength,
+    };
+  }
+  
   static #lockFilePath(backupDirPath) {
     return join(backupDirPath, HB_EDIT_LOCK_FILE);
   }
@@ -376,54 +393,86 @@ class BackupManager {
     }
   }
   
+  #getTempDirPath() {
+    return join(this.#backupDirPath, 'temp');
+  }
+  
+  async #acquireTempDir() {
+    const tmpDirPath = this.#getTempDirPath();
+    
+    // creation and removal of the shared temp dir are serialized so a concurrent release cannot remove it while in use
+    await this.#tempDirLocks.run(tmpDirPath, async () => {
+      await mkdir(tmpDirPath, { recursive: true });
+      this.#tempDirUsers++;
+    });
+    
+    return tmpDirPath;
+  }
+  
+  async #releaseTempDir() {
+    const tmpDirPath = this.#getTempDirPath();
+    
+    await this.#tempDirLocks.run(tmpDirPath, async () => {
+      this.#tempDirUsers--;
+      
+      if (this.#tempDirUsers == 0 && (await readdir(tmpDirPath)).length == 0) {
+        await rmdir(tmpDirPath);
+      }
+    });
+  }
+  
   async #fileIsInStore(fileHashHex) {
     const filePath = this.#getPathOfFile(fileHashHex);
     
     return await fileOrFolderExists(filePath);
   }
   
-  async #getAndAddFileToMeta({
+  async #addFileToMeta({
     fileHashHex,
     size,
     compressionUsed,
     compressedSize,
   }) {
-    const newFilePath = this.#getPathOfFile(fileHashHex);
     const metaFilePath = this.#getMetaPathOfFile(fileHashHex);
     
-    let metaJson;
-    
-    if (await fileOrFolderExists(metaFilePath)) {
-      metaJson = JSON.parse((await readLargeFile(metaFilePath)).toString());
-    } else {
-      await mkdir(dirname(metaFilePath), { recursive: true });
-      metaJson = {};
-    }
-    
-    const metaEntry = {
-      size,
-      ...(
-        compressionUsed ?
-          {
-            compressedSize,
-            compression: {
-              algorithm: this.#compressionAlgo,
-              ...this.#compressionParams,
-            },
-          } :
-          {}
-      ),
-    };
-    
-    metaJson[fileHashHex] = metaEntry;
-    
-    this.#addMetaEntryToCache(fileHashHex, metaEntry);
-    
-    return {
-      newFilePath,
-      metaFilePath,
-      metaJson,
-    };
+    // meta files are shared between hashes, so the read-modify-write must not interleave
+    await this.#metaFileLocks.run(metaFilePath, async () => {
+      let metaJson;
+      
+      if (await fileOrFolderExists(metaFilePath)) {
+        metaJson = JSON.parse((await readLargeFile(metaFilePath)).toString());
+      } else {
+        await mkdir(dirname(metaFilePath), { recursive: true });
+        metaJson = {};
+      }
+      
+      const metaEntry = {
+        size,
+        ...(
+          compressionUsed ?
+            {
+              compressedSize,
+              compression: {
+                algorithm: this.#compressionAlgo,
+                ...this.#compressionParams,
+              },
+            } :
+            {}
+        ),
+      };
+      
+      metaJson[fileHashHex] = metaEntry;
+      
+      // sorted so the meta file contents do not depend on which concurrently added file finished first
+      metaJson = Object.fromEntries(
+        Object.entries(metaJson)
+          .sort(([hashA], [hashB]) => hashA < hashB ? -1 : hashA > hashB ? 1 : 0)
+      );
+      
+      await writeFileReplaceWhenDone(metaFilePath, metaFileStringify(metaJson));
+      
+      this.#addMetaEntryToCache(fileHashHex, metaEntry);
+    });
   }
   
   async #addFilePathBytesToStore({
@@ -433,7 +482,8 @@ class BackupManager {
     compressionMinimumSizeThreshold,
     compressionMaximumSizeThreshold,
     pastBackupEntry,
-    logger,
+    hashWorkerPool,
+    log,
   }) {
     if (pastBackupEntry != null) {
       if (
@@ -441,62 +491,64 @@ class BackupManager {
         pastBackupEntry.ctime == ctime &&
         pastBackupEntry.birthtime == birthtime
       ) {
-        this.#log(logger, 'File already in backup dir (modtime check)');
+        log('File already in backup dir (modtime check)');
         return pastBackupEntry.hash;
       }
     }
     
-    const fileBytes = await readLargeFile(filePath);
+    const { fileHashHex, fileBytes: fileBytesArray } = await hashWorkerPool.run({
+      task: 'hashFileBytes',
+      args: this.#hashWorkerArgs(filePath),
+    });
     
-    const fileHashHex = await this.#hashBytes(fileBytes);
+    // the file bytes arrive from the worker as a plain Uint8Array
+    const fileBytes = Buffer.from(fileBytesArray.buffer, fileBytesArray.byteOffset, fileBytesArray.byteLength);
     
-    this.#log(logger, `Hash: ${fileHashHex}`);
+    log(`Hash: ${fileHashHex}`);
     
-    if (await this.#fileIsInStore(fileHashHex)) {
-      if (checkForDuplicateHashes) {
-        const storeFileBytes = await this.#getFileBytesFromStore(fileHashHex);
-        
-        if (!fileBytes.equals(storeFileBytes)) {
-          throw new Error(`Hash Collision Found: ${JSON.stringify(this.#getPathOfFile(fileHashHex))} and fileBytes (path ${JSON.stringify(filePath)}) have same ${this.#hashAlgo} hash: ${fileHashHex}`);
+    await this.#fileStoreLocks.run(fileHashHex, async () => {
+      if (await this.#fileIsInStore(fileHashHex)) {
+        if (checkForDuplicateHashes) {
+          const storeFileBytes = await this.#getFileBytesFromStore(fileHashHex);
+          
+          if (!fileBytes.equals(storeFileBytes)) {
+            throw new Error(`Hash Collision Found: ${JSON.stringify(this.#getPathOfFile(fileHashHex))} and fileBytes (path ${JSON.stringify(filePath)}) have same ${this.#hashAlgo} hash: ${fileHashHex}`);
+          }
         }
-      }
-      
-      this.#log(logger, 'File already in backup dir');
-    } else {
-      this.#log(logger, 'File not in backup dir, adding');
-      
-      let compressionUsed = false;
-      let compressedBytes;
-      
-      if (this.#compressionAlgo != null && fileBytes.length >= compressionMinimumSizeThreshold && fileBytes.length <= compressionMaximumSizeThreshold) {
-        compressedBytes = await compressBytes(fileBytes, this.#compressionAlgo, this.#compressionParams);
         
-        if (compressedBytes.length < fileBytes.length) {
-          this.#log(logger, `Compressed with ${this.#compressionAlgo} (${JSON.stringify(this.#compressionParams)}) from ${fileBytes.length} bytes to ${compressedBytes.length} bytes`);
-          compressionUsed = true;
+        log('File already in backup dir');
+      } else {
+        log('File not in backup dir, adding');
+        
+        let compressionUsed = false;
+        let compressedBytes;
+        
+        if (this.#compressionAlgo != null && fileBytes.length >= compressionMinimumSizeThreshold && fileBytes.length <= compressionMaximumSizeThreshold) {
+          compressedBytes = await compressBytes(fileBytes, this.#compressionAlgo, this.#compressionParams);
+          
+          if (compressedBytes.length < fileBytes.length) {
+            log(`Compressed with ${this.#compressionAlgo} (${JSON.stringify(this.#compressionParams)}) from ${fileBytes.length} bytes to ${compressedBytes.length} bytes`);
+            compressionUsed = true;
+          } else {
+            log(`Not compressed with ${this.#compressionAlgo} (${JSON.stringify(this.#compressionParams)}) as file size increases from ${fileBytes.length} bytes to ${compressedBytes.length} bytes`);
+          }
         } else {
-          this.#log(logger, `Not compressed with ${this.#compressionAlgo} (${JSON.stringify(this.#compressionParams)}) as file size increases from ${fileBytes.length} bytes to ${compressedBytes.length} bytes`);
+          log(`File size: ${fileBytes.length} bytes`);
         }
-      } else {
-        this.#log(logger, `File size: ${fileBytes.length} bytes`);
-      }
-      
-      const {
-        newFilePath,
-        metaFilePath,
-        metaJson,
-      } = await this.#getAndAddFileToMeta({
-        fileHashHex,
-        size: fileBytes.length,
-        compressionUsed,
-        compressedSize: compressedBytes?.length,
-      });
-      
-      await mkdir(dirname(newFilePath), { recursive: true });
-      await writeFileReplaceWhenDone(newFilePath, compressionUsed ? compressedBytes : fileBytes, { readonly: true });
-      await mkdir(dirname(metaFilePath), { recursive: true });
-      await writeFileReplaceWhenDone(metaFilePath, metaFileStringify(metaJson));
-    }
+        
+        const newFilePath = this.#getPathOfFile(fileHashHex);
+        
+        await mkdir(dirname(newFilePath), { recursive: true });
+        await writeFileReplaceWhenDone(newFilePath, compressionUsed ? compressedBytes : fileBytes, { readonly: true });
+        
+        await this.#addFileToMeta({
+          fileHashHex,
+          size: fileBytes.length,
+          compressionUsed,
+          compressedSize: compressedBytes?.length,
+        });
+      }
+    });
     
     return fileHashHex;
   }
@@ -515,7 +567,8 @@ class BackupManager {
     compressionMinimumSizeThreshold,
     compressionMaximumSizeThreshold,
     pastBackupEntry,
-    logger,
+    hashWorkerPool,
+    log,
   }) {
     if (pastBackupEntry != null) {
       if (
@@ -523,7 +576,7 @@ class BackupManager {
         pastBackupEntry.ctime == ctime &&
         pastBackupEntry.birthtime == birthtime
       ) {
-        this.#log(logger, 'File already in backup dir (modtime check)');
+        log('File already in backup dir (modtime check)');
         return pastBackupEntry.hash;
       }
     }
@@ -531,108 +584,110 @@ class BackupManager {
     const fileHandle = await open(filePath);
     
     try {
-      const fileHashHex = (await this.#hashStream(BackupManager.#reusablyGetReadStream(fileHandle))).toString('hex');
-      
-      this.#log(logger, `Hash: ${fileHashHex}`);
+      const { fileHashHex } = await hashWorkerPool.run({
+        task: 'hashFileStream',
+        args: this.#hashWorkerArgs(filePath),
+      });
       
-      if (await this.#fileIsInStore(fileHashHex)) {
-        if (checkForDuplicateHashes) {
-          const storeFileStream = await this.#getFileStreamFromStore(fileHashHex);
-          
-          if (!(await streamsEqual([BackupManager.#reusablyGetReadStream(fileHandle), storeFileStream]))) {
-            throw new Error(`Hash Collision Found: ${JSON.stringify(this.#getPathOfFile(fileHashHex))} and ${JSON.stringify(filePath)} have same ${this.#hashAlgo} hash: ${fileHashHex}`);
+      log(`Hash: ${fileHashHex}`);
+      
+      await this.#fileStoreLocks.run(fileHashHex, async () => {
+        if (await this.#fileIsInStore(fileHashHex)) {
+          if (checkForDuplicateHashes) {
+            const fileEqualsStoreFile = await hashWorkerPool.run({
+              task: 'fileEqualsStoreFile',
+              args: {
+                filePath,
+                storeFilePath: this.#getPathOfFile(fileHashHex),
+                storeFileCompression: (await this.#getFileMeta(fileHashHex)).compression,
+              },
+            });
+            
+            if (!fileEqualsStoreFile) {
+              throw new Error(`Hash Collision Found: ${JSON.stringify(this.#getPathOfFile(fileHashHex))} and ${JSON.stringify(filePath)} have same ${this.#hashAlgo} hash: ${fileHashHex}`);
+            }
           }
-        }
-      
-        this.#log(logger, 'File already in backup dir');
-      } else {
-        this.#log(logger, 'File not in backup dir, adding');
         
-        let compressionUsed = false;
-        
-        const { size: fileSize } = await fileHandle.stat();
-        
-        if (this.#compressionAlgo != null && fileSize >= compressionMinimumSizeThreshold && fileSize <= compressionMaximumSizeThreshold) {
-          const tmpDirPath = join(this.#backupDirPath, 'temp');
-          await mkdir(tmpDirPath, { recursive: true });
+          log('File already in backup dir');
+        } else {
+          log('File not in backup dir, adding');
           
-          try {
-            const compressedFilePath = join(tmpDirPath, fileHashHex);
-            const fileStream = BackupManager.#reusablyGetReadStream(fileHandle);
-            const compressor = createCompressor(this.#compressionAlgo, this.#compressionParams, fileSize);
-            const compressedFile = createWriteStream(compressedFilePath);
-            
-            await pipeline(
-              fileStream,
-              compressor,
-              compressedFile
-            );
+          let compressionUsed = false;
+          
+          const { size: fileSize } = await fileHandle.stat();
+          
+          if (this.#compressionAlgo != null && fileSize >= compressionMinimumSizeThreshold && fileSize <= compressionMaximumSizeThreshold) {
+            const tmpDirPath = await this.#acquireTempDir();
             
-            let compressedSize;
-            if (compressedFile.closed) {
-              compressedSize = compressedFile.bytesWritten;
-            } else {
-              await new Promise(r => {
-                compressedFile.once('close', () => {
-                  r(compressedSize);
+            try {
+              const compressedFilePath = join(tmpDirPath, fileHashHex);
+              const fileStream = BackupManager.#reusablyGetReadStream(fileHandle);
+              const compressor = createCompressor(this.#compressionAlgo, this.#compressionParams, fileSize);
+              const compressedFile = createWriteStream(compressedFilePath);
+              
+              await pipeline(
+                fileStream,
+                compressor,
+                compressedFile
+              );
+              
+              let compressedSize;
+              if (compressedFile.closed) {
+                compressedSize = compressedFile.bytesWritten;
+              } else {
+                await new Promise(r => {
+                  compressedFile.once('close', () => {
+                    r(compressedSize);
+                  });
                 });
+              }
+              
+              if (compressedSize < fileStream.bytesRead) {
+                log(`Compressed with ${this.#compressionAlgo} (${JSON.stringify(this.#compressionParams)}) from ${fileStream.bytesRead} bytes to ${compressedSize} bytes`);
+                compressionUsed = true;
+              } else {
+                log(`Not compressed with ${this.#compressionAlgo} (${JSON.stringify(this.#compressionParams)}) as file size increases from ${fileStream.bytesRead} bytes to ${compressedSize} bytes`);
+                await unlink(compressedFilePath);
+              }
+              
+              const newFilePath = this.#getPathOfFile(fileHashHex);
+              
+              await mkdir(dirname(newFilePath), { recursive: true });
+              if (compressionUsed) {
+                await setReadOnly(compressedFilePath, true);
+                await rename(compressedFilePath, newFilePath);
+              } else {
+                await copyFile(filePath, newFilePath);
+                await setReadOnly(newFilePath, true);
+              }
+              
+              await this.#addFileToMeta({
+                fileHashHex,
+                size: fileSize,
+                compressionUsed,
+                compressedSize,
               });
+            } finally {
+              await this.#releaseTempDir();
             }
+          } else {
+            log(`File size: ${fileSize} bytes`);
             
-            if (compressedSize < fileStream.bytesRead) {
-              this.#log(logger, `Compressed with ${this.#compressionAlgo} (${JSON.stringify(this.#compressionParams)}) from ${fileStream.bytesRead} bytes to ${compressedSize} bytes`);
-              compressionUsed = true;
-            } else {
-              this.#log(logger, `Not compressed with ${this.#compressionAlgo} (${JSON.stringify(this.#compressionParams)}) as file size increases from ${fileStream.bytesRead} bytes to ${compressedSize} bytes`);
-              await unlink(compressedFilePath);
-            }
+            const newFilePath = this.#getPathOfFile(fileHashHex);
             
-            const {
-              newFilePath,
-              metaFilePath,
-              metaJson,
-            } = await this.#getAndAddFileToMeta({
+            await mkdir(dirname(newFilePath), { recursive: true });
+            await copyFile(filePath, newFilePath);
+            await setReadOnly(newFilePath, true);
+            
+            await this.#addFileToMeta({
               fileHashHex,
               size: fileSize,
-              compressionUsed,
-              compressedSize,
+              compressionUsed: false,
+              compressedSize: null,
             });
-            
-            await mkdir(dirname(newFilePath), { recursive: true });
-            if (compressionUsed) {
-              await setReadOnly(compressedFilePath, true);
-              await rename(compressedFilePath, newFilePath);
-            } else {
-              await copyFile(filePath, newFilePath);
-              await setReadOnly(newFilePath, true);
-            }
-            await writeFileReplaceWhenDone(metaFilePath, metaFileStringify(metaJson));
-          } finally {
-            if ((await readdir(tmpDirPath)).length == 0) {
-              await rmdir(tmpDirPath);
-            }
           }
-        } else {
-          this.#log(logger, `File size: ${fileSize} bytes`);
-          
-          const {
-            newFilePath,
-            metaFilePath,
-            metaJson,
-          } = await this.#getAndAddFileToMeta({
-            fileHashHex,
-            size: fileSize,
-            compressionUsed: false,
-            compressedSize: null,
-          });
-            
-          await mkdir(dirname(newFilePath), { recursive: true });
-          await copyFile(filePath, newFilePath);
-          await writeFileReplaceWhenDone(metaFilePath, metaFileStringify(metaJson));
-          
-          await setReadOnly(newFilePath, true);
         }
-      }
+      });
       
       return fileHashHex;
     } finally {
@@ -830,14 +885,15 @@ class BackupManager {
     compressionMaximumSizeThreshold,
     checkForDuplicateHashes,
     pastBackupEntry = null,
-    logger,
+    hashWorkerPool,
+    log,
   }) {
     const backupEntry = await getAndAddBackupEntry({
       baseFileOrFolderPath,
       subFileOrFolderPath,
       stats,
       symlinkType,
-      addingLogger: data => this.#log(logger, data),
+      addingLogger: data => log(data),
       addFileToStoreFunc: async ({
         mtime,
         ctime,
@@ -852,7 +908,8 @@ class BackupManager {
             compressionMinimumSizeThreshold,
             compressionMaximumSizeThreshold,
             pastBackupEntry,
-            logger,
+            hashWorkerPool,
+            log,
           });
         } else {
           return await this.#addFilePathStreamToStore({
@@ -862,7 +919,8 @@ class BackupManager {
             compressionMinimumSizeThreshold,
             compressionMaximumSizeThreshold,
             pastBackupEntry,
-            logger,
+            hashWorkerPool,
+            log,
           });
         }
       },
@@ -1457,6 +1515,8 @@ class BackupManager {
     compressionMaximumSizeThreshold = Infinity,
     checkForDuplicateHashes = true,
     ignoreErrors = false,
+    smallFileConcurrency = DEFAULT_SMALL_FILE_CONCURRENCY,
+    largeFileConcurrency = DEFAULT_LARGE_FILE_CONCURRENCY,
     timestampOnlyFileIdenticalCheckBackup: timestampCheckBackup = null,
     logger = null,
   }) {
@@ -1508,6 +1568,14 @@ class BackupManager {
       throw new Error(`ignoreErrors not boolean: ${typeof ignoreErrors}`);
     }
     
+    if (!Number.isSafeInteger(smallFileConcurrency) || smallFileConcurrency < 1) {
+      throw new Error(`smallFileConcurrency not integer >= 1: ${smallFileConcurrency}`);
+    }
+    
+    if (!Number.isSafeInteger(largeFileConcurrency) || largeFileConcurrency < 1) {
+      throw new Error(`largeFileConcurrency not integer >= 1: ${largeFileConcurrency}`);
+    }
+    
     if (typeof timestampCheckBackup != 'string' && timestampCheckBackup != null) {
       throw new Error(`timestampOnlyFileIdenticalCheckBackup not string or null: ${typeof timestampCheckBackup}`);
     }
@@ -1584,52 +1652,108 @@ class BackupManager {
       storeSymlinkType,
     });
     
-    let newEntries = [];
+    // files above the in memory cutoff get their own lane with its own workers, so a backlog of
+    // large files cannot hold up small ones (or the reverse); small lane files are read fully into
+    // memory, so peak memory use is roughly smallFileConcurrency * inMemoryCutoffSize
+    let smallFileLaneIndices = [];
+    let largeFileLaneIndices = [];
+    
+    for (let i = 0; i < dirContents.length; i++) {
+      const { stats } = dirContents[i];
+      
+      if (!stats.isDirectory() && !stats.isSymbolicLink() && stats.size > inMemoryCutoffSize) {
+        largeFileLaneIndices.push(i);
+      } else {
+        smallFileLaneIndices.push(i);
+      }
+    }
+    
+    // entries are stored by index, so the backup file order does not depend on completion order
+    let newEntries = new Array(dirContents.length).fill(null);
+    let firstErrorIndex = null;
+    let firstError;
     
-    for (const { filePath, stats, symlinkType } of dirContents) {
+    const processEntry = async i => {
+      const { filePath, stats, symlinkType } = dirContents[i];
+      
       const backupInternalNativePath = relative(fileOrFolderPath, filePath);
       const relativeFilePath =
         backupInternalNativePath == '' ?
           '.' :
           splitPath(backupInternalNativePath).join(BACKUP_PATH_SEP);
       
-      if (ignoreErrors) {
-        try {
-          newEntries.push(
-            await this.#addAndGetBackupEntry({
-              baseFileOrFolderPath: fileOrFolderPath,
-              subFileOrFolderPath: filePath,
-              stats,
-              symlinkType,
-              inMemoryCutoffSize,
-              compressionMinimumSizeThreshold,
-              compressionMaximumSizeThreshold,
-              checkForDuplicateHashes,
-              pastBackupEntry: subtreeInfo?.get?.(relativeFilePath),
-              logger,
-            })
-          );
-        } catch (err) {
-          this.#log(logger, `ERROR: msg:${err.toString()} code:${err.code} stack:\n${err.stack}`);
+      // entries are added concurrently, so each line names its entry to keep the log readable
+      const entryLog = data => this.#log(logger, `${JSON.stringify(relativeFilePath)}: ${data}`);
+      
+      try {
+        newEntries[i] = await this.#addAndGetBackupEntry({
+          baseFileOrFolderPath: fileOrFolderPath,
+          subFileOrFolderPath: filePath,
+          stats,
+          symlinkType,
+          inMemoryCutoffSize,
+          compressionMinimumSizeThreshold,
+          compressionMaximumSizeThreshold,
+          checkForDuplicateHashes,
+          pastBackupEntry: subtreeInfo?.get?.(relativeFilePath),
+          hashWorkerPool,
+          log: entryLog,
+        });
+      } catch (err) {
+        if (ignoreErrors) {
+          entryLog(`ERROR: skipping ${JSON.stringify(filePath)}: msg:${err.toString()} code:${err.code} stack:\n${err.stack}`);
+        } else if (firstErrorIndex == null || i < firstErrorIndex) {
+          firstErrorIndex = i;
+          firstError = err;
         }
-      } else {
-        newEntries.push(
-          await this.#addAndGetBackupEntry({
-            baseFileOrFolderPath: fileOrFolderPath,
-            subFileOrFolderPath: filePath,
-            stats,
-            symlinkType,
-            inMemoryCutoffSize,
-            compressionMinimumSizeThreshold,
-            compressionMaximumSizeThreshold,
-            checkForDuplicateHashes,
-            pastBackupEntry: subtreeInfo?.get?.(relativeFilePath),
-            logger,
-          })
-        );
       }
+    };
+    
+    const runLane = async (laneIndices, workerCount) => {
+      let nextLanePosition = 0;
+      
+      const runWorker = async () => {
+        // after a failure, entries before the failing one are still added (as a sequential backup would,
+        // possibly finding an earlier failure), but no entry after it is started
+        while (
+          nextLanePosition < laneIndices.length &&
+          (firstErrorIndex == null || laneIndices[nextLanePosition] < firstErrorIndex)
+        ) {
+          await processEntry(laneIndices[nextLanePosition++]);
+        }
+      };
+      
+      let workers = [];
+      
+      for (let i = 0; i < Math.min(workerCount, laneIndices.length); i++) {
+        workers.push(runWorker());
+      }
+      
+      await Promise.all(workers);
+    };
+    
+    // hashing (and comparing against the store) happens on worker threads, as it would otherwise
+    // serialize every lane on the main thread
+    const hashWorkerPool = new WorkerPool(
+      new URL('./hash_worker.mjs', import.meta.url),
+      Math.min(availableParallelism(), smallFileConcurrency + largeFileConcurrency)
+    );
+    
+    try {
+      await Promise.all([
+        runLane(smallFileLaneIndices, smallFileConcurrency),
+        runLane(largeFileLaneIndices, largeFileConcurrency),
+      ]);
+    } finally {
+      await hashWorkerPool.terminate();
     }
     
+    if (firstErrorIndex != null) {
+      throw firstError;
+    }
+    
+    newEntries = newEntries.filter(entry => entry != null);
+    
     this.#log(logger, 'Writing backup file...');
     
     const finishedBackupData = {
@@ -0,0 +1,84 @@
+import { createReadStream } from 'node:fs';
+import { parentPort } from 'node:worker_threads';
+
+import { readLargeFile } from '../lib/fs.mjs';
+import { streamsEqual } from '../lib/stream_equality.mjs';
+import {
+  createDecompressor,
+  hashBytes,
+  hashStream,
+  splitCompressObjectAlgoAndParams,
+} from './lib.mjs';
+
+// worker thread for WorkerPool, so that hashing files (and comparing them against the store) while
+// adding them to a backup is spread over cores instead of all running on the main thread
+
+async function hashFileBytes({ filePath, hashAlgo, hashParams, hashOutputTrimLength }) {
+  const fileBytes = await readLargeFile(filePath);
+  
+  const fileHashHex = await hashBytes(fileBytes, hashAlgo, hashParams, hashOutputTrimLength);
+  
+  // the whole underlying buffer is only moved to the main thread (instead of copied) if it belongs to this file alone
+  const fileBytesOwnBuffer = fileBytes.byteOffset == 0 && fileBytes.byteLength == fileBytes.buffer.byteLength;
+  
+  return {
+    result: { fileHashHex, fileBytes },
+    transferList: fileBytesOwnBuffer ? [fileBytes.buffer] : [],
+  };
+}
+
+async function hashFileStream({ filePath, hashAlgo, hashParams, hashOutputTrimLength }) {
+  const fileHashHex = await hashStream(createReadStream(filePath), hashAlgo, hashParams, hashOutputTrimLength);
+  
+  return {
+    result: { fileHashHex },
+    transferList: [],
+  };
+}
+
+async function fileEqualsStoreFile({ filePath, storeFilePath, storeFileCompression }) {
+  const rawStoreFileStream = createReadStream(storeFilePath);
+  
+  let storeFileStream;
+  
+  if (storeFileCompression != null) {
+    const { compressionAlgo, compressionParams } = splitCompressObjectAlgoAndParams(storeFileCompression);
+    
+    storeFileStream = createDecompressor(compressionAlgo, compressionParams);
+    
+    rawStoreFileStream.pipe(storeFileStream);
+  } else {
+    storeFileStream = rawStoreFileStream;
+  }
+  
+  return {
+    result: await streamsEqual([createReadStream(filePath), storeFileStream]),
+    transferList: [],
+  };
+}
+
+const TASKS = {
+  hashFileBytes,
+  hashFileStream,
+  fileEqualsStoreFile,
+};
+
+parentPort.on('message', async ({ task, args }) => {
+  try {
+    if (!(task in TASKS)) {
+      throw new Error(`task unknown: ${task}`);
+    }
+    
+    const { result, transferList } = await TASKS[task](args);
+    
+    parentPort.postMessage({ result }, transferList);
+  } catch (err) {
+    parentPort.postMessage({
+      error: {
+        message: err.message,
+        code: err.code,
+        stack: err.stack,
+      },
+    });
+  }
+});
@@ -1,4 +1,8 @@
-import { DEFAULT_IN_MEMORY_CUTOFF_SIZE } from '../backup_manager/backup_manager.mjs';
+import {
+  DEFAULT_IN_MEMORY_CUTOFF_SIZE,
+  DEFAULT_LARGE_FILE_CONCURRENCY,
+  DEFAULT_SMALL_FILE_CONCURRENCY,
+} from '../backup_manager/backup_manager.mjs';
 import { splitLongLinesByWord } from '../lib/command_line.mjs';
 import { integerToStringWithSeparator } from '../lib/number.mjs';
 import { getNativeLibInstalled } from '../backup_manager/version.mjs';
@@ -379,6 +383,26 @@ export const COMMANDS = new Map(
             },
           ],
           
+          [
+            'smallFileConcurrency',
+            
+            {
+              aliases: ['small-file-concurrency'],
+              defaultValue: DEFAULT_SMALL_FILE_CONCURRENCY + '',
+              conversion: toInteger,
+            },
+          ],
+          
+          [
+            'largeFileConcurrency',
+            
+            {
+              aliases: ['large-file-concurrency'],
+              defaultValue: DEFAULT_LARGE_FILE_CONCURRENCY + '',
+              conversion: toInteger,
+            },
+          ],
+          
           [
             'timestampOnlyFileIdenticalCheckBackup',
             
@@ -419,6 +443,10 @@ export const COMMANDS = new Map(
           '        aliases: --check-duplicate-hashes',
           '    --ignoreErrors (default false): If true, errors when adding a file to the backup will be ignored and the file will not be added to the backup.',
           '        aliases: --ignore-errors',
+          `    --smallFileConcurrency=<integer >= 1> (default \`${DEFAULT_SMALL_FILE_CONCURRENCY}\`): The number of files at or below the in memory cutoff (and folders and symlinks) that are added to the backup at the same time. The backup file lists entries in the same order regardless. Each of these files is read fully into memory, so peak memory use is roughly smallFileConcurrency * inMemoryCutoff (plus compressed copies); lower this when using a large or Infinity inMemoryCutoff.`,
+          '        aliases: --small-file-concurrency',
+          `    --largeFileConcurrency=<integer >= 1> (default \`${DEFAULT_LARGE_FILE_CONCURRENCY}\`): The number of files above the in memory cutoff that are streamed into the backup at the same time. Files are hashed on up to smallFileConcurrency + largeFileConcurrency worker threads (no more than the number of CPUs).`,
+          '        aliases: --large-file-concurrency',
           '    --timestampOnlyFileIdenticalCheckBackup: If this is set, it is a backup name whose timestamps will exclusively be used to decide if pathToBackup files need to be added, instead of reading the entire file contents, checking the hash, and if identical, checking the file in the hash backup for a collision. This should be much faster, at the expense of not knowing if the file has secretly changed while keeping timestamps the same.',
           '        aliases: --timestamp-only-file-identical-check-backup',
         ].join('\n'),
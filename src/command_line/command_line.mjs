@@ -723,6 +723,8 @@ export async function executeCommandLine({
           compressionMaximumSizeThreshold: keyedArgs.get('compressionMaximumSizeThreshold'),
           checkForDuplicateHashes: keyedArgs.get('checkDuplicateHashes'),
           ignoreErrors: keyedArgs.get('ignoreErrors'),
+          smallFileConcurrency: keyedArgs.get('smallFileConcurrency'),
+          largeFileConcurrency: keyedArgs.get('largeFileConcurrency'),
           timestampOnlyFileIdenticalCheckBackup: keyedArgs.get('timestampOnlyFileIdenticalCheckBackup'),
           logger,
         });
@@ -0,0 +1,27 @@
+export class KeyedAsyncMutex {
+  // key -> promise of last queued holder for that key
+  #tails = new Map();
+  
+  async run(key, func) {
+    const previousTail = this.#tails.get(key) ?? Promise.resolve();
+    
+    let releaseFunc;
+    const ownTail = new Promise(r => {
+      releaseFunc = r;
+    });
+    
+    this.#tails.set(key, ownTail);
+    
+    await previousTail;
+    
+    try {
+      return await func();
+    } finally {
+      if (this.#tails.get(key) == ownTail) {
+        this.#tails.delete(key);
+      }
+      
+      releaseFunc();
+    }
+  }
+}
@@ -0,0 +1,138 @@
+import { Worker } from 'node:worker_threads';
+
+// runs tasks on a lazily grown set of worker threads; each worker handles one task at a time
+// and answers each task message with { result } or { error: { message, code, stack } }
+export class WorkerPool {
+  #workerPath;
+  #maxWorkers;
+  #workers = [];
+  #idleWorkers = [];
+  // worker -> { resolve, reject } of the task it is running
+  #runningTasks = new Map();
+  // tasks waiting for a worker: { message, transferList, resolve, reject }
+  #queuedTasks = [];
+  #terminated = false;
+  
+  constructor(workerPath, maxWorkers) {
+    if (!(workerPath instanceof URL) && typeof workerPath != 'string') {
+      throw new Error(`workerPath not URL or string: ${typeof workerPath}`);
+    }
+    
+    if (!Number.isSafeInteger(maxWorkers) || maxWorkers < 1) {
+      throw new Error(`maxWorkers not integer >= 1: ${maxWorkers}`);
+    }
+    
+    this.#workerPath = workerPath;
+    this.#maxWorkers = maxWorkers;
+  }
+  
+  #spawnWorker() {
+    const worker = new Worker(this.#workerPath);
+    
+    worker.on('message', ({ result, error }) => {
+      const { resolve, reject } = this.#runningTasks.get(worker);
+      this.#runningTasks.delete(worker);
+      
+      if (error != null) {
+        const err = new Error(error.message);
+        err.code = error.code;
+        err.stack = error.stack;
+        reject(err);
+      } else {
+        resolve(result);
+      }
+      
+      this.#workerFree(worker);
+    });
+    
+    worker.on('error', err => {
+      this.#removeWorker(worker);
+      
+      const task = this.#runningTasks.get(worker);
+      
+      if (task != null) {
+        this.#runningTasks.delete(worker);
+        task.reject(err);
+      }
+    });
+    
+    worker.on('exit', () => {
+      this.#removeWorker(worker);
+      
+      const task = this.#runningTasks.get(worker);
+      
+      if (task != null) {
+        this.#runningTasks.delete(worker);
+        task.reject(new Error('worker exited while running task'));
+      }
+      
+      // a replacement worker picks up any tasks still queued
+      if (!this.#terminated && this.#queuedTasks.length > 0 && this.#workers.length < this.#maxWorkers) {
+        this.#workerFree(this.#spawnWorker());
+      }
+    });
+    
+    this.#workers.push(worker);
+    
+    return worker;
+  }
+  
+  #removeWorker(worker) {
+    const workerIndex = this.#workers.indexOf(worker);
+    
+    if (workerIndex != -1) {
+      this.#workers.splice(workerIndex, 1);
+    }
+    
+    const idleWorkerIndex = this.#idleWorkers.indexOf(worker);
+    
+    if (idleWorkerIndex != -1) {
+      this.#idleWorkers.splice(idleWorkerIndex, 1);
+    }
+  }
+  
+  #startTask(worker, { message, transferList, resolve, reject }) {
+    this.#runningTasks.set(worker, { resolve, reject });
+    worker.postMessage(message, transferList);
+  }
+  
+  #workerFree(worker) {
+    if (this.#queuedTasks.length > 0) {
+      this.#startTask(worker, this.#queuedTasks.shift());
+    } else {
+      this.#idleWorkers.push(worker);
+    }
+  }
+  
+  async run(message, transferList = []) {
+    if (this.#terminated) {
+      throw new Error('worker pool terminated');
+    }
+    
+    return await new Promise((resolve, reject) => {
+      const task = { message, transferList, resolve, reject };
+      
+      if (this.#idleWorkers.length > 0) {
+        this.#startTask(this.#idleWorkers.pop(), task);
+      } else if (this.#workers.length < this.#maxWorkers) {
+        this.#startTask(this.#spawnWorker(), task);
+      } else {
+        this.#queuedTasks.push(task);
+      }
+    });
+  }
+  
+  async terminate() {
+    this.#terminated = true;
+    
+    for (const { reject } of this.#queuedTasks) {
+      reject(new Error('worker pool terminated'));
+    }
+    
+    this.#queuedTasks = [];
+    
+    await Promise.all(
+      [...this.#workers].map(worker => worker.terminate())
+    );
+  }
+}
@@ -1,3 +1,6 @@
+import { readFile } from 'node:fs/promises';
+import { relative } from 'node:path';
+
 import { getAndAddBackupEntry } from '../../src/backup_manager/lib.mjs';
 import { recursiveReaddir } from '../../src/lib/fs.mjs';
 
@@ -32,3 +35,15 @@ export async function getFilesAndMetaInDir(basePath, excludedDirs) {
       })
   );
 }
+
+export async function getFileContentsInDir(basePath) {
+  let fileContents = {};
+  
+  for (const { filePath, stats } of await recursiveReaddir(basePath, { sorted: true })) {
+    if (stats.isFile()) {
+      fileContents[relative(basePath, filePath)] = (await readFile(filePath)).toString('base64');
+    }
+  }
+  
+  return fileContents;
+}
@@ -13,6 +13,7 @@ import {
   nostream = no testing of stream-only mode
   notimestamp = no testing of timestamp mode
   nocontents = no testing of file contents only mode
+  noconcurrency = no testing of concurrent backups against sequential ones
   auto | noauto = do not pause (auto) or pause (noauto) at end of each test for user input
 */
 
@@ -26,6 +27,7 @@ const KNOWN_ARGS = new Set([
   'nostream',
   'notimestamp',
   'nocontents',
+  'noconcurrency',
   'auto',
   'noauto',
 ]);
@@ -39,7 +41,7 @@ for (const arg of args) {
 }
 
 if (args.has('onlyminor')) {
-  performMinorTests();
+  await performMinorTests();
 } else {
   await performMainTest({
     testDeliberateModification: !args.has('nomodif'),
@@ -56,6 +58,7 @@ if (args.has('onlyminor')) {
     streamOnlySubTest: !args.has('nostream'),
     timestampOnlySubtest: !args.has('notimestamp'),
     contentsOnlySubtest: !args.has('nocontents'),
+    concurrencySubtest: !args.has('noconcurrency'),
     ...(
       args.has('auto') || args.has('noauto') ?
         {
@@ -14,6 +14,7 @@ import {
   symlink,
   writeFile,
 } from 'node:fs/promises';
+import { createServer } from 'node:net';
 import {
   join,
   resolve,
@@ -22,14 +23,26 @@ import { formatWithOptions as utilFormatWithOptions } from 'node:util';
 
 import {
   getBackupInfo,
+  getSubtree,
   initBackupDir,
+  listBackups,
   performBackup,
   performRestore,
 } from '../src/backup_manager/backup_helper_funcs.mjs';
+import {
+  HB_BACKUP_META_DIRECTORY,
+  HB_FILE_DIRECTORY,
+  HB_FILE_META_DIRECTORY,
+} from '../src/backup_manager/lib.mjs';
+import { KeyedAsyncMutex } from '../src/lib/async_lock.mjs';
 import { parseArgs } from '../src/lib/command_line.mjs';
 import { setReadOnly } from '../src/lib/fs.mjs';
+import { callProcess } from '../src/lib/process.mjs';
 
-import { getFilesAndMetaInDir } from './lib/fs.mjs';
+import {
+  getFileContentsInDir,
+  getFilesAndMetaInDir,
+} from './lib/fs.mjs';
 import { AdvancedPrng } from './lib/prng_extended.mjs';
 
 export const DEFAULT_TEST_RANDOM_NAME = false;
@@ -762,6 +775,202 @@ async function performSubTest({
   }
 }
 
+// returns a function that undoes the unreadability, so the test dir can be removed
+async function createUnreadableFile(filePath) {
+  if (process.platform == 'win32') {
+    await writeFile(filePath, 'unreadable file');
+    await callProcess({
+      processName: 'icacls',
+      processArguments: [filePath, '/deny', '*S-1-1-0:(RD)'],
+    });
+    
+    return async () => {
+      await callProcess({
+        processName: 'icacls',
+        processArguments: [filePath, '/remove:d', '*S-1-1-0'],
+      });
+    };
+  } else {
+    // a unix socket cannot be opened for reading, even as root
+    const server = createServer();
+    
+    await new Promise((r, j) => {
+      server.once('error', j);
+      server.listen(filePath, r);
+    });
+    
+    return async () => {
+      await new Promise(r => server.close(r));
+    };
+  }
+}
+
+async function performConcurrencySubTest({
+  doNotSaveTestDirIfTestPassed,
+  logger,
+}) {
+  let testMgr = new TestManager({ logger });
+  
+  await mkdir(TESTS_DIR, { recursive: true });
+  
+  const testDir = join(TESTS_DIR, `test-concurrency-${Date.now() - new Date('2025-01-01T00:00:00.000Z').getTime()}`);
+  await mkdir(testDir);
+  
+  let errorOccurred = false;
+  
+  try {
+    await createTestDirectoryContents(testMgr, testDir);
+    
+    let dataNames = ['manual1', 'manual2', 'manual3', 'manual4'];
+    for (let i = 0; i < 10; i++) {
+      dataNames.push('random' + i);
+      dataNames.push('random' + i + '.1');
+    }
+    
+    // the random dirs share copies of the same files, so duplicate contents land in the same meta files;
+    // the cutoff is inside the random file size range, so both lanes are used
+    const runs = [
+      { backupDirName: 'backup-sequential', smallFileConcurrency: 1, largeFileConcurrency: 1 },
+      { backupDirName: 'backup-concurrent', smallFileConcurrency: 16, largeFileConcurrency: 4 },
+    ];
+    
+    for (const { backupDirName, smallFileConcurrency, largeFileConcurrency } of runs) {
+      const backupDir = join(testDir, backupDirName);
+      await mkdir(backupDir);
+      
+      await initBackupDir({
+        backupDir,
+        hash: 'sha256',
+        hashSliceLength: 2,
+        hashSlices: 1,
+        compressAlgo: 'brotli',
+        logger: testMgr.getBoundLogger(),
+      });
+      
+      for (const name of dataNames) {
+        await performBackup({
+          backupDir,
+          name,
+          basePath: join(testDir, 'data', name),
+          inMemoryCutoffSize: 8000,
+          smallFileConcurrency,
+          largeFileConcurrency,
+          logger: testMgr.getBoundLogger(),
+        });
+      }
+    }
+    
+    testMgr.timestampLog('comparing sequential and concurrent backup dirs');
+    
+    const sequentialBackupDir = join(testDir, 'backup-sequential');
+    const concurrentBackupDir = join(testDir, 'backup-concurrent');
+    
+    const getBackupFiles = async backupDir =>
+      Object.fromEntries(
+        Object.entries(await getFileContentsInDir(join(backupDir, HB_BACKUP_META_DIRECTORY)))
+          .map(([ fileName, contents ]) => {
+            const { createdAt: _, entries } = JSON.parse(Buffer.from(contents, 'base64').toString());
+            // the first run's reads update access times, so those cannot match between runs
+            return [fileName, entries.map(({ atime: _atime, ...entry }) => entry)];
+          })
+      );
+    
+    deepStrictEqual(await getBackupFiles(concurrentBackupDir), await getBackupFiles(sequentialBackupDir));
+    deepStrictEqual(
+      await getFileContentsInDir(join(concurrentBackupDir, HB_FILE_META_DIRECTORY)),
+      await getFileContentsInDir(join(sequentialBackupDir, HB_FILE_META_DIRECTORY))
+    );
+    deepStrictEqual(
+      await getFileContentsInDir(join(concurrentBackupDir, HB_FILE_DIRECTORY)),
+      await getFileContentsInDir(join(sequentialBackupDir, HB_FILE_DIRECTORY))
+    );
+    
+    testMgr.timestampLog('testing ignoreErrors with concurrency');
+    
+    const unreadableDataDir = join(testDir, 'data', 'unreadable');
+    await cp(join(testDir, 'data', 'random0'), unreadableDataDir, { recursive: true });
+    const unreadableFilePath = join(unreadableDataDir, 'unreadable');
+    const undoUnreadable = await createUnreadableFile(unreadableFilePath);
+    
+    try {
+      let logLines = [];
+      
+      await performBackup({
+        backupDir: concurrentBackupDir,
+        name: 'unreadable-ignored',
+        basePath: unreadableDataDir,
+        inMemoryCutoffSize: 8000,
+        smallFileConcurrency: 16,
+        largeFileConcurrency: 4,
+        ignoreErrors: true,
+        logger: data => {
+          logLines.push(data);
+          testMgr.timestampLog(data);
+        },
+      });
+      
+      const backupPaths = (await getSubtree({
+        backupDir: concurrentBackupDir,
+        name: 'unreadable-ignored',
+        logger: testMgr.getBoundLogger(),
+      })).map(({ path }) => path);
+      
+      if (backupPaths.includes('unreadable')) {
+        throw new Error('unreadable file present in backup despite error');
+      }
+      
+      const expectedPaths = (await getFilesAndMetaInDir(join(testDir, 'data', 'random0'))).map(({ path }) => path);
+      
+      deepStrictEqual(new Set(backupPaths), new Set(expectedPaths));
+      
+      if (!logLines.some(data => typeof data == 'string' && data.startsWith(`"unreadable": ERROR: skipping ${JSON.stringify(unreadableFilePath)}`))) {
+        throw new Error('ignored error log line does not name the unreadable file');
+      }
+      
+      let errorThrown = false;
+      
+      try {
+        await performBackup({
+          backupDir: concurrentBackupDir,
+          name: 'unreadable-not-ignored',
+          basePath: unreadableDataDir,
+          inMemoryCutoffSize: 8000,
+          smallFileConcurrency: 16,
+          largeFileConcurrency: 4,
+          logger: testMgr.getBoundLogger(),
+        });
+      } catch {
+        errorThrown = true;
+      }
+      
+      if (!errorThrown) {
+        throw new Error('backup of unreadable file did not error without ignoreErrors');
+      }
+      
+      if ((await listBackups({ backupDir: concurrentBackupDir, logger: testMgr.getBoundLogger() })).includes('unreadable-not-ignored')) {
+        throw new Error('failed backup was still written');
+      }
+    } finally {
+      await undoUnreadable();
+    }
+    
+    testMgr.timestampLog('concurrency subtest finished');
+  } catch (err) {
+    errorOccurred = true;
+    await mkdir(LOGS_DIR, { recursive: true });
+    await testMgr.writeLogFile();
+    throw err;
+  } finally {
+    if (!errorOccurred && doNotSaveTestDirIfTestPassed) {
+      await rm(testDir, { recursive: true });
+      await removeDirIfEmpty(TESTS_DIR);
+      await removeDirIfEmpty(TEST_DATA_DIR);
+    }
+    
+    logger('Done with concurrency subtest');
+  }
+}
+
 export async function performMainTest({
   // "test" random name and content functions by printing to console their results 10x:
   testOnlyRandomName = DEFAULT_TEST_RANDOM_NAME,
@@ -781,6 +990,7 @@ export async function performMainTest({
   streamOnlySubTest = true,
   timestampOnlySubtest = true,
   contentsOnlySubtest = true,
+  concurrencySubtest = true,
 } = {}) {
   if (testOnlyRandomName) {
     let randomMgr = new RandomManager();
@@ -796,7 +1006,14 @@ export async function performMainTest({
   }
   
   if (includeMinor) {
-    performMinorTests({ logger });
+    await performMinorTests({ logger });
+  }
+  
+  if (concurrencySubtest) {
+    await performConcurrencySubTest({
+      doNotSaveTestDirIfTestPassed,
+      logger,
+    });
   }
   
   if (memoryOnlySubTest) {
@@ -882,7 +1099,75 @@ function arrayParseArgs(args) {
   };
 }
 
-export function performMinorTests({
+async function withTestTimeout(promise, description) {
+  let timeout;
+  
+  try {
+    return await Promise.race([
+      promise,
+      new Promise((_, j) => {
+        timeout = setTimeout(() => j(new Error(`timed out: ${description}`)), 5_000);
+      }),
+    ]);
+  } finally {
+    clearTimeout(timeout);
+  }
+}
+
+async function performAsyncLockTests({ logger }) {
+  // KeyedAsyncMutex runs one func per key at a time in FIFO order, while different keys run together
+  
+  {
+    const mutex = new KeyedAsyncMutex();
+    let activeByKey = new Map();
+    let maxActiveByKey = new Map();
+    let maxActiveTotal = 0;
+    let order = [];
+    
+    await withTestTimeout(
+      Promise.all(
+        ['a', 'b', 'a', 'b', 'a'].map(async (key, i) => {
+          await mutex.run(key, async () => {
+            activeByKey.set(key, (activeByKey.get(key) ?? 0) + 1);
+            maxActiveByKey.set(key, Math.max(maxActiveByKey.get(key) ?? 0, activeByKey.get(key)));
+            maxActiveTotal = Math.max(maxActiveTotal, Array.from(activeByKey.values()).reduce((a, b) => a + b, 0));
+            order.push(i);
+            await new Promise(r => setImmediate(r));
+            activeByKey.set(key, activeByKey.get(key) - 1);
+          });
+        })
+      ),
+      'keyed mutex exclusion'
+    );
+    
+    deepStrictEqual(Object.fromEntries(maxActiveByKey), { a: 1, b: 1 });
+    deepStrictEqual(maxActiveTotal, 2);
+    deepStrictEqual(order.filter(i => i % 2 == 0), [0, 2, 4]);
+  }
+  
+  // KeyedAsyncMutex releases the key when func throws
+  
+  {
+    const mutex = new KeyedAsyncMutex();
+    let errorThrown = false;
+    
+    try {
+      await mutex.run('a', async () => {
+        await new Promise(r => setImmediate(r));
+        throw new Error('deliberate error');
+      });
+    } catch {
+      errorThrown = true;
+    }
+    
+    deepStrictEqual(errorThrown, true);
+    deepStrictEqual(await withTestTimeout(mutex.run('a', async () => 'free'), 'keyed mutex release after throw'), 'free');
+  }
+  
+  logger('Async lock test successful');
+}
+
+export async function performMinorTests({
   logger = console.log,
 } = {}) {
   // test parseArgs
@@ -966,4 +1251,6 @@ export function performMinorTests({
   );
   
   logger('Parseargs test successful');
+  
+  await performAsyncLockTests({ logger });
 }